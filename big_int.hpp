@@ -0,0 +1,42 @@
+/**
+ * Copyright 2023 Topi Törmä, Matti Vapa
+ */
+
+#ifndef BIG_INT
+#define BIG_INT
+
+// This program can use either fixed width integers (i.e. integers that have a finite number of bits),
+// or arbitrary precision integrers.
+// The supported fixed width types are the 128, 256, 512 and 1024 bit integers from Boost.
+#ifdef FIXED_WIDTH_INTEGERS
+#ifndef INTEGER_WIDTH
+#define INTEGER_WIDTH 1024
+#endif
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/math/tools/precision.hpp>
+#if INTEGER_WIDTH == 128
+using BigInt = boost::multiprecision::int128_t;
+#elif INTEGER_WIDTH == 256
+using BigInt = boost::multiprecision::int256_t;
+#elif INTEGER_WIDTH == 512
+using BigInt = boost::multiprecision::int512_t;
+#elif INTEGER_WIDTH == 1024
+using BigInt = boost::multiprecision::int1024_t;
+#endif
+#include <cmath>
+
+// Checks that subdividing a pair with the given (larger) denominator can not overflow the integers in the next iteration.
+inline bool subdivision_fits(const BigInt& den, int N) {
+    return boost::multiprecision::pow(den, 6) < boost::math::tools::max_value<BigInt>() / (static_cast<BigInt>(8 * std::pow(N, 7)));
+}
+#endif
+
+// For arbitrary precision integers we use the NTL/ZZ types.
+#ifndef FIXED_WIDTH_INTEGERS
+#include <NTL/ZZ.h>
+#define ARBITRARY_WIDTH_INTEGERS
+// Use arbitrary integers instead.
+using BigInt = NTL::ZZ;
+#endif
+
+#endif
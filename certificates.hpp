@@ -0,0 +1,283 @@
+/**
+ * Copyright 2023 Topi Törmä, Matti Vapa
+ */
+
+#ifndef CERTIFICATES
+#define CERTIFICATES
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "littlewood.hpp"
+
+/**
+ * Proof certificates record why each leaf of the search tree was accepted, so that a run can be
+ * checked afterwards without repeating the search.
+ *
+ * A node of the search tree is identified by the index of its initial pair in the processed bucket
+ * (the root) and by the path of digits t used in the subdivisions leading to it. A certificate is
+ * written for every accepted leaf (with the accepting Q and the step of the algorithm that accepted
+ * it) and for every node where the cutoff in subdivide was reached (with the best Q and the first
+ * digit that was cut off). Subdivided nodes without a cutoff are implicit.
+ *
+ * The file starts with a header, followed by chunks. Each chunk is a varint byte length followed
+ * by the records, and a chunk of length zero ends the file. Each record is encoded as
+ *
+ *     step, root, shared prefix length, suffix length, suffix digits, Q byte count, Q bytes [, cutoff digit]
+ *
+ * where the path is stored as the suffix that differs from the previous record of the same chunk,
+ * Q is stored in little-endian byte order and the cutoff digit is only present for cutoff records.
+ * All integers except the step and the bytes of Q are unsigned LEB128 varints.
+ */
+namespace certificates {
+
+    const std::string magic = "LWC1";
+
+    // Chunks are written out once they grow beyond this size.
+    const std::size_t chunk_size = 1 << 20;
+
+    using path = std::vector<int>;
+
+    struct header {
+        int N;
+        unsigned int buckets;
+        unsigned int bucket;
+        std::uint64_t root_count;
+    };
+
+    template <typename T>
+    struct record {
+        LW::acceptance_step step;
+        std::uint64_t root;
+        path digits;
+        T q;
+        int cutoff_digit;
+    };
+
+    // Records waiting to be written, together with the state needed for the prefix encoding.
+    struct chunk {
+        std::string bytes;
+        std::uint64_t previous_root;
+        path previous_digits;
+    };
+
+    inline void write_varint(std::string& output, std::uint64_t value) {
+        while (value >= 0x80) {
+            output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        output.push_back(static_cast<char>(value));
+    }
+
+    inline std::uint64_t read_varint(const std::string& input, std::size_t& position) {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (position >= input.size()) {
+                throw std::runtime_error("Unexpected end of certificate data.");
+            }
+            auto byte = static_cast<unsigned char>(input[position++]);
+            // Only the lowest bit of the tenth byte fits into 64 bits.
+            if (shift == 63 && byte > 1) {
+                break;
+            }
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Malformed varint in certificate data.");
+    }
+
+    // Checks that a decoded varint fits into the type it is stored in.
+    template <typename I>
+    I narrow(std::uint64_t value) {
+        if (value > static_cast<std::uint64_t>(std::numeric_limits<I>::max())) {
+            throw std::runtime_error("Value out of range in certificate data.");
+        }
+        return static_cast<I>(value);
+    }
+
+    template <typename T>
+    unsigned int lowest_byte(const T& value) {
+        if constexpr (std::is_constructible_v<unsigned int, T>) {
+            return static_cast<unsigned int>(static_cast<T>(value % 256));
+        } else {
+            // NTL::ZZ has no conversion operators, but its remainder by a long is a long.
+            long byte = value % 256;
+            return static_cast<unsigned int>(byte);
+        }
+    }
+
+    template <typename T>
+    void write_integer(std::string& output, T value) {
+        assert(value >= 0);
+        std::string bytes;
+        while (value > 0) {
+            bytes.push_back(static_cast<char>(lowest_byte(value)));
+            value /= 256;
+        }
+        write_varint(output, bytes.size());
+        output += bytes;
+    }
+
+    template <typename T>
+    T read_integer(const std::string& input, std::size_t& position) {
+        std::uint64_t length = read_varint(input, position);
+        if (length > input.size() - position) {
+            throw std::runtime_error("Unexpected end of certificate data.");
+        }
+        // Fixed width integers would silently wrap around.
+        if (std::numeric_limits<T>::is_bounded && length * 8 > static_cast<std::uint64_t>(std::numeric_limits<T>::digits)) {
+            throw std::runtime_error("Integer too wide in certificate data.");
+        }
+        // The bytes are combined into groups of 7 bytes, so that most values need a single big integer operation.
+        T value = static_cast<T>(0);
+        std::uint64_t i = length;
+        while (i > 0) {
+            std::uint64_t group_length = (i - 1) % 7 + 1;
+            long group = 0;
+            for (std::uint64_t j = 0; j < group_length; j++) {
+                group = (group << 8) | static_cast<unsigned char>(input[position + i - 1 - j]);
+            }
+            value = value * (1L << (8 * group_length)) + group;
+            i -= group_length;
+        }
+        position += length;
+        return value;
+    }
+
+    template <typename T>
+    void append(chunk& output, LW::acceptance_step step, std::uint64_t root, const path& digits, const T& q, int cutoff_digit = 0) {
+        std::size_t shared = 0;
+        if (!output.bytes.empty() && root == output.previous_root) {
+            while (shared < digits.size() && shared < output.previous_digits.size() && digits[shared] == output.previous_digits[shared]) {
+                shared++;
+            }
+        }
+
+        output.bytes.push_back(static_cast<char>(step));
+        write_varint(output.bytes, root);
+        write_varint(output.bytes, shared);
+        write_varint(output.bytes, digits.size() - shared);
+        for (std::size_t i = shared; i < digits.size(); i++) {
+            write_varint(output.bytes, digits[i]);
+        }
+        write_integer(output.bytes, q);
+        if (step == LW::acceptance_step::cutoff) {
+            write_varint(output.bytes, cutoff_digit);
+        }
+
+        output.previous_root = root;
+        output.previous_digits = digits;
+    }
+
+    /**
+     * Decodes the next record of a chunk starting from position. The previous record of the same
+     * chunk must be passed in as the record, since the path is stored relative to it.
+     */
+    template <typename T>
+    void read_record(const std::string& input, std::size_t& position, record<T>& result) {
+        auto step = static_cast<unsigned char>(input[position++]);
+        if (step == 0 || step > static_cast<unsigned char>(LW::acceptance_step::cutoff)) {
+            throw std::runtime_error("Unknown step in certificate data.");
+        }
+        result.step = static_cast<LW::acceptance_step>(step);
+        result.root = read_varint(input, position);
+        std::uint64_t shared = read_varint(input, position);
+        if (shared > result.digits.size()) {
+            throw std::runtime_error("Malformed path in certificate data.");
+        }
+        result.digits.resize(shared);
+        std::uint64_t suffix = read_varint(input, position);
+        for (std::uint64_t i = 0; i < suffix; i++) {
+            result.digits.push_back(narrow<int>(read_varint(input, position)));
+        }
+        result.q = read_integer<T>(input, position);
+        result.cutoff_digit = 0;
+        if (result.step == LW::acceptance_step::cutoff) {
+            result.cutoff_digit = narrow<int>(read_varint(input, position));
+        }
+    }
+
+    inline void write_header(std::ostream& output, const header& values) {
+        std::string bytes = magic;
+        write_varint(bytes, values.N);
+        write_varint(bytes, values.buckets);
+        write_varint(bytes, values.bucket);
+        write_varint(bytes, values.root_count);
+        output.write(bytes.data(), bytes.size());
+    }
+
+    // Writes the chunk to the output and clears it.
+    inline void write_chunk(std::ostream& output, chunk& records) {
+        if (records.bytes.empty()) {
+            return;
+        }
+        std::string length;
+        write_varint(length, records.bytes.size());
+        output.write(length.data(), length.size());
+        output.write(records.bytes.data(), records.bytes.size());
+        records.bytes.clear();
+        records.previous_digits.clear();
+    }
+
+    // Writes the empty chunk that marks the end of the file.
+    inline void write_end(std::ostream& output) {
+        output.put('\0');
+    }
+
+    inline std::uint64_t read_stream_varint(std::istream& input) {
+        std::string bytes;
+        int c;
+        do {
+            c = input.get();
+            if (c == EOF) {
+                throw std::runtime_error("Unexpected end of certificate file.");
+            }
+            bytes.push_back(static_cast<char>(c));
+        } while (c >= 0x80 && bytes.size() < 10);
+        std::size_t position = 0;
+        return read_varint(bytes, position);
+    }
+
+    inline header read_header(std::istream& input) {
+        std::string bytes(magic.size(), '\0');
+        input.read(bytes.data(), bytes.size());
+        if (!input || bytes != magic) {
+            throw std::runtime_error("Not a certificate file.");
+        }
+        header values;
+        values.N = narrow<int>(read_stream_varint(input));
+        values.buckets = narrow<unsigned int>(read_stream_varint(input));
+        values.bucket = narrow<unsigned int>(read_stream_varint(input));
+        values.root_count = read_stream_varint(input);
+        return values;
+    }
+
+    // Reads the next chunk into bytes. Returns false once the terminating empty chunk is reached.
+    // The chunk is read in pieces of at most chunk_size bytes, so that a corrupted length can not
+    // allocate more memory than there is data in the file.
+    inline bool read_chunk(std::istream& input, std::string& bytes) {
+        std::uint64_t length = read_stream_varint(input);
+        bytes.clear();
+        while (bytes.size() < length) {
+            std::size_t start = bytes.size();
+            std::size_t piece = static_cast<std::size_t>(std::min<std::uint64_t>(length - start, chunk_size));
+            bytes.resize(start + piece);
+            input.read(bytes.data() + start, piece);
+            if (!input) {
+                throw std::runtime_error("Unexpected end of certificate file.");
+            }
+        }
+        return length > 0;
+    }
+}
+
+#endif
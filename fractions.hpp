@@ -5,6 +5,7 @@
 #ifndef FRACTIONS
 #define FRACTIONS
 
+#include <cassert>
 #include <vector>
 
 namespace fractions {
@@ -44,10 +45,24 @@ namespace fractions {
         };
     }
 
+    // Helper method for creating the child pair ([0;b_1,\ldots,b_n,t], [0;d_1,\ldots,d_m])
+    // of a pair, rearranged so that B_n <= D_m.
+    template <typename T>
+    convergent_pair<T> child_pair(const convergent_pair<T>& pair, int digit) {
+        convergent next = next_convergent(pair.alpha, static_cast<T>(digit));
+
+        if (next.current.den < pair.beta.current.den) {
+            return {next, pair.beta};
+        } else {
+            return {pair.beta, next};
+        }
+    }
+
     // Method for dividing a pair of convergents into N-1 new pairs
     // (Step 2c in the algorithm: ([0;b_1,\ldots,b_n], [0;d_1,\ldots,d_m])
     // is replaced with ([0;b_1,\ldots,b_n,t], [0;d_1,\ldots,d_m])
     // for 1 <= t <= N-1. Also the new pairs are rearranged so that B_n <= D_m.)
+    // The child for digit t is placed at index t-1 of the results.
     template <typename T, typename F>
     void subdivide(const convergent_pair<T>& pair, int N, F&& cutoff_condition, std::vector<convergent_pair<T>>& results) {
         for (int i = 1; i < N; i++) {
@@ -56,13 +71,7 @@ namespace fractions {
                 break;
             }
 
-            convergent next = next_convergent(pair.alpha, static_cast<T>(i));
-
-            if (next.current.den < pair.beta.current.den) {
-                results.push_back({next, pair.beta});
-            } else {
-                results.push_back({pair.beta, next});
-            }
+            results.push_back(child_pair(pair, i));
         }
     }
 
@@ -132,6 +141,28 @@ namespace fractions {
         
         return pairs;
     }
+
+    /**
+     * Selects every buckets:th pair, starting from the pair at index bucket - 1.
+     */
+    template <typename T>
+    std::vector<convergent_pair<T>> select_bucket(const std::vector<convergent_pair<T>>& pairs, unsigned int buckets, unsigned int bucket) {
+        assert(pairs.size() >= buckets);
+
+        if (buckets == 1) {
+            return pairs;
+        }
+
+        std::vector<convergent_pair<T>> selected = {};
+
+        std::size_t index = bucket - 1;
+        while (index < pairs.size()) {
+            selected.push_back(pairs[index]);
+            index += buckets;
+        }
+
+        return selected;
+    }
 }
 
 #endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define LITTLEWOOD
 
 #include <algorithm>
+#include <cstdint>
 #include "fractions.hpp"
 #include "modular_math.hpp"
 
@@ -16,12 +17,37 @@ namespace LW {
         return result;
     }
 
+    // The step of the algorithm that accepted a pair. The values are written as such into the
+    // proof certificates, so they should not be reordered.
+    enum class acceptance_step : std::uint8_t {
+        none = 0,
+        step_2a = 1,
+        step_2b_i = 2,
+        step_2b_ii = 3,
+        step_2b_iii = 4,
+        step_2b_iv = 5,
+        step_2b_v = 6,
+        cutoff = 7
+    };
+
+    // If the pair meets the criteria, best_q is the Q that was accepted and step tells which
+    // check accepted it. Otherwise best_q is the Q with the lowest "Littlewood quantity".
     template <typename T>
     struct littlewood_result {
         T best_q;
         bool meets_criteria;
+        acceptance_step step;
     };
     
+    /**
+     * max_remainder corresponds to the "suitably large integer" described in step 2 (b) of the algorithm in the article.
+     * Specifically this corresponds to M + 1 to make the condition of the while loop in meets_littlewood_criteria a bit neater.
+     */
+    template <typename T>
+    T max_remainder(const fractions::convergent_pair<T>& pair, int N) {
+        return static_cast<T>(1) + std::max(static_cast<T>(N), pair.beta.previous.den / (2 * N * N));
+    }
+
     template <typename T>
     littlewood_result<T> meets_littlewood_criteria(const fractions::convergent_pair<T>& pair, int N) {
         
@@ -38,7 +64,7 @@ namespace LW {
         T alpha_remainder = modular_math::remainder_with_least_absolute_value(beta.current.den, alpha.current);
         T littlewood_quantity = littlewood(beta.current.den, alpha_remainder * alpha_sum, static_cast<T>(0), N);
         if (littlewood_quantity < epsilon) {
-            return {static_cast<T>(0), true};
+            return {beta.current.den, true, acceptance_step::step_2a};
         }
 
         // Track the Q that gives the lowest value for the "Littlewood quantity".
@@ -67,9 +93,7 @@ namespace LW {
         T bca_rem = beta_den_comp_alpha_num;
         T ma_rem = multiple_alpha;
 
-        // max_remainder corresponds to the "suitably large integer" described in step 2 (b) of the algorithm in the article.
-        // Specifically this corresponds to M + 1 to make the condition of the while loop below a bit neater.
-        T max_remainder = static_cast<T>(1) + std::max(static_cast<T>(N), pair.beta.previous.den / (2 * N * N));
+        T max_remainder = LW::max_remainder(pair, N);
         // target_remainder corresponds to the r described in step 2 (b) of the algorithm in the article.
         T target_remainder = static_cast<T>(1);
         
@@ -79,7 +103,7 @@ namespace LW {
             // The following checks correspond to the substeps i - v in the step 2 (b) of the algorithm.
             littlewood_quantity = littlewood(denominators[0], target_remainder * alpha_sum, std::min(ab_rem, beta.current.den - ab_rem) * beta_sum, N);
             if (littlewood_quantity < epsilon) {
-                return {static_cast<T>(0), true};
+                return {denominators[0], true, acceptance_step::step_2b_i};
             } else if (littlewood_quantity < lowest_littlewood_quantity) {
                 lowest_littlewood_quantity = littlewood_quantity;
                 best_q = denominators[0];
@@ -87,7 +111,7 @@ namespace LW {
 
             littlewood_quantity = littlewood(denominators[1], target_remainder * alpha_sum, std::min(acb_rem, beta.current.den - acb_rem) * beta_sum, N);
             if (littlewood_quantity < epsilon) {
-                return {static_cast<T>(0), true};
+                return {denominators[1], true, acceptance_step::step_2b_ii};
             } else if (littlewood_quantity < lowest_littlewood_quantity) {
                 lowest_littlewood_quantity = littlewood_quantity;
                 best_q = denominators[1];
@@ -95,7 +119,7 @@ namespace LW {
 
             littlewood_quantity = littlewood(denominators[2], std::min(ba_rem, alpha.current.den - ba_rem) * alpha_sum, target_remainder * beta_sum, N);
             if (littlewood_quantity < epsilon) {
-                return {static_cast<T>(0), true};
+                return {denominators[2], true, acceptance_step::step_2b_iii};
             } else if (littlewood_quantity < lowest_littlewood_quantity) {
                 lowest_littlewood_quantity = littlewood_quantity;
                 best_q = denominators[2];
@@ -103,7 +127,7 @@ namespace LW {
 
             littlewood_quantity = littlewood(denominators[3], std::min(bca_rem, alpha.current.den - bca_rem) * alpha_sum, target_remainder * beta_sum, N);
             if (littlewood_quantity < epsilon) {
-                return {static_cast<T>(0), true};
+                return {denominators[3], true, acceptance_step::step_2b_iv};
             } else if (littlewood_quantity < lowest_littlewood_quantity) {
                 lowest_littlewood_quantity = littlewood_quantity;
                 best_q = denominators[3];
@@ -111,7 +135,7 @@ namespace LW {
 
             littlewood_quantity = littlewood(target_remainder * alpha.current.den, static_cast<T>(0), std::min(ma_rem, beta.current.den - ma_rem) * beta_sum, N);
             if (littlewood_quantity < epsilon) {
-                return {static_cast<T>(0), true};
+                return {target_remainder * alpha.current.den, true, acceptance_step::step_2b_v};
             } else if (littlewood_quantity < lowest_littlewood_quantity) {
                 lowest_littlewood_quantity = littlewood_quantity;
                 best_q = target_remainder * alpha.current.den;
@@ -165,7 +189,7 @@ namespace LW {
         }
         
         // The current pair did not meet the Littlewood criteria for any value of r, so we just return the best q.
-        return {best_q, false};
+        return {best_q, false, acceptance_step::none};
     }
 
     /**
@@ -180,6 +204,79 @@ namespace LW {
         T b = beta_sum * modular_math::remainder_with_least_absolute_value(best_q, beta.current);
         return littlewood(best_q, a, b, N) < new_epsilon;
     }
+
+    /**
+     * Checks with a single evaluation of the "Littlewood quantity" that q is good for the given pair.
+     * Every Q accepted by meets_littlewood_criteria passes this check, since the remainders used there
+     * are upper bounds for the least absolute remainders used here.
+     */
+    template <typename T>
+    bool accepts(const fractions::convergent_pair<T>& pair, T q, int N) {
+        if (q <= 0) {
+            return false;
+        }
+        T alpha_sum = pair.alpha.current.den + pair.alpha.previous.den;
+        T beta_sum = pair.beta.current.den + pair.beta.previous.den;
+        T epsilon = pair.alpha.current.den * alpha_sum * pair.beta.current.den * beta_sum;
+        T a = alpha_sum * modular_math::remainder_with_least_absolute_value(q, pair.alpha.current);
+        T b = beta_sum * modular_math::remainder_with_least_absolute_value(q, pair.beta.current);
+        return littlewood(q, a, b, N) < epsilon;
+    }
+
+    /**
+     * Checks that q is one of the denominators of the substeps i - iv of step 2 (b), i.e. that q is
+     * r * B_{n-1} (or r * (B_n - B_{n-1}) when complement is set) reduced into the range (0, B_n] for some r < max_remainder.
+     */
+    template <typename T>
+    bool is_reduced_multiple(T q, const fractions::convergent<T>& number, bool complement, T max_remainder) {
+        if (q <= 0 || q > number.current.den) {
+            return false;
+        }
+        // A_n * B_{n-1} - A_{n-1} * B_n = +-1, so A_n is the inverse of +-B_{n-1} modulo B_n and r can be solved from q.
+        T determinant = number.current.num * number.previous.den - number.previous.num * number.current.den;
+        T r = (q * number.current.num) % number.current.den;
+        if ((determinant < 0) != complement) {
+            r = number.current.den - r;
+        }
+        if (r == 0) {
+            r = number.current.den;
+        }
+        return r < max_remainder;
+    }
+
+    /**
+     * Checks that q has the form of the Q's that the given step of meets_littlewood_criteria checks.
+     * The cutoff uses the best Q found by meets_littlewood_criteria, which can have the form of any of the steps.
+     * This also bounds q, so that checking it can not overflow any more than the search itself.
+     */
+    template <typename T>
+    bool has_step_form(const fractions::convergent_pair<T>& pair, T q, acceptance_step step, int N) {
+        T max_r = max_remainder(pair, N);
+        switch (step) {
+            case acceptance_step::step_2a:
+                return q == pair.beta.current.den;
+            case acceptance_step::step_2b_i:
+                return is_reduced_multiple(q, pair.alpha, false, max_r);
+            case acceptance_step::step_2b_ii:
+                return is_reduced_multiple(q, pair.alpha, true, max_r);
+            case acceptance_step::step_2b_iii:
+                return is_reduced_multiple(q, pair.beta, false, max_r);
+            case acceptance_step::step_2b_iv:
+                return is_reduced_multiple(q, pair.beta, true, max_r);
+            case acceptance_step::step_2b_v:
+                return q > 0 && q % pair.alpha.current.den == 0 && q / pair.alpha.current.den < max_r;
+            case acceptance_step::cutoff:
+                for (auto form : {acceptance_step::step_2a, acceptance_step::step_2b_i, acceptance_step::step_2b_ii,
+                                  acceptance_step::step_2b_iii, acceptance_step::step_2b_iv, acceptance_step::step_2b_v}) {
+                    if (has_step_form(pair, q, form, N)) {
+                        return true;
+                    }
+                }
+                return false;
+            default:
+                return false;
+        }
+    }
 }
 
 #endif
\ No newline at end of file
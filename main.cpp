@@ -12,42 +12,18 @@
 #include <mutex>
 #include <functional>
 #include <chrono>
+#include <fstream>
 #define FMT_HEADER_ONLY
 #include "dependencies/fmt/include/fmt/format.h"
+#include "big_int.hpp"
+#include "certificates.hpp"
 #include "fractions.hpp"
 #include "littlewood.hpp"
 #include "visualisation.hpp"
 
-// This program can use either fixed width integers (i.e. integers that have a finite number of bits),
-// or arbitrary precision integrers.
-// The supported fixed width types are the 128, 256, 512 and 1024 bit integers from Boost.
-#ifdef FIXED_WIDTH_INTEGERS
-#ifndef INTEGER_WIDTH
-#define INTEGER_WIDTH 1024
-#endif
-#include <boost/multiprecision/cpp_int.hpp>
-#include <boost/math/tools/precision.hpp>
-#if INTEGER_WIDTH == 128
-using BigInt = boost::multiprecision::int128_t;
-#elif INTEGER_WIDTH == 256
-using BigInt = boost::multiprecision::int256_t;
-#elif INTEGER_WIDTH == 512
-using BigInt = boost::multiprecision::int512_t;
-#elif INTEGER_WIDTH == 1024
-using BigInt = boost::multiprecision::int1024_t;
-#endif
-#endif
-
-// For arbitrary precision integers we use the NTL/ZZ types.
-#ifndef FIXED_WIDTH_INTEGERS
-#include <NTL/ZZ.h>
-#define ARBITRARY_WIDTH_INTEGERS
-// Use arbitrary integers instead.
-using BigInt = NTL::ZZ;
-#endif
-
 std::mutex work_queue_mutex;
 std::mutex thread_status_mutex;
+std::mutex certificate_mutex;
 
 int thread_count = 1;
 int done_thread_count = 0;
@@ -59,11 +35,13 @@ struct configuration {
     uint buckets;
     uint bucket;
     bool only_print_initial_pairs;
+    // Proof certificates are written to this file, if it is not empty.
+    std::string certificate_file;
 };
 
 // Very naive CLI argument parser
 configuration parse_cli_arguments(int argc, char* argv[]) {
-    configuration config = {10, 1, 1, 1, false};
+    configuration config = {10, 1, 1, 1, false, ""};
     if (argc > 1) {
         for (int i = 1; i < argc; i++) {
             auto argument = std::string(argv[i]);
@@ -78,6 +56,8 @@ configuration parse_cli_arguments(int argc, char* argv[]) {
                 config.bucket = std::stoi(argument.substr(2));
             } else if (handle == "-p") {
                 config.only_print_initial_pairs = true;
+            } else if (handle == "-c") {
+                config.certificate_file = argument.substr(2);
             }
         }
     }
@@ -110,11 +90,23 @@ void decrement_done_thread_count() {
     thread_status_mutex.unlock();
 }
 
+// A pair in the work queue. When certificates are written, root is the index of the initial pair the
+// pair was subdivided from and path lists the digits used in the subdivisions.
+template <typename T>
+struct work_item {
+    fractions::convergent_pair<T> pair;
+    std::uint64_t root;
+    certificates::path path;
+};
+
 template <typename T>
-void process(std::vector<fractions::convergent_pair<T>>& queue, int N) {
+void process(std::vector<work_item<T>>& queue, int N, std::ostream* certificate_output) {
     
     bool done = false;
 
+    // Certificates are collected into a chunk of our own and written out once the chunk is large enough.
+    certificates::chunk certificate_chunk = {};
+
     // Until all threads have marked themselves as done, we need to try processing pairs from the queue.
     while (!all_threads_done()) {
         
@@ -130,12 +122,22 @@ void process(std::vector<fractions::convergent_pair<T>>& queue, int N) {
             }
 
             // Get a new pair to work on and unlock the mutex.
-            auto pair = std::move(queue.back());
+            auto item = std::move(queue.back());
             queue.pop_back();
             work_queue_mutex.unlock();
 
+            const fractions::convergent_pair<T>& pair = item.pair;
+
             LW::littlewood_result result = LW::meets_littlewood_criteria(pair, N);
             if (result.meets_criteria) {
+                if (certificate_output) {
+                    certificates::append(certificate_chunk, result.step, item.root, item.path, result.best_q);
+                    if (certificate_chunk.bytes.size() >= certificates::chunk_size) {
+                        certificate_mutex.lock();
+                        certificates::write_chunk(*certificate_output, certificate_chunk);
+                        certificate_mutex.unlock();
+                    }
+                }
                 // The pair passes the criteria, so we can forget about it and jump back to the start of the loop.
                 continue;
             }
@@ -143,21 +145,42 @@ void process(std::vector<fractions::convergent_pair<T>>& queue, int N) {
             #if defined(FIXED_WIDTH_INTEGERS) && defined(OVERFLOW_PROTECTION)
             // If we are using fixed width integers, this check should guarantee that we can't overflow the
             // integer in the next iteration.
-            assert(boost::multiprecision::pow(pair.beta.current.den, 6) < boost::math::tools::max_value<BigInt>() / (static_cast<BigInt>(8 * std::pow(N, 7))));
+            assert(subdivision_fits(pair.beta.current.den, N));
             #endif
 
-            auto cutoff_condition = [result, N](const fractions::convergent<T>& alpha, const fractions::convergent<T>& beta, int next_digit) {
-                return LW::littlewood_cutoff_reached(result.best_q, alpha, beta, next_digit, N);
+            // The first digit for which the cutoff was reached, or 0 if it was not reached.
+            int cutoff_digit = 0;
+            auto cutoff_condition = [result, N, &cutoff_digit](const fractions::convergent<T>& alpha, const fractions::convergent<T>& beta, int next_digit) {
+                bool reached = LW::littlewood_cutoff_reached(result.best_q, alpha, beta, next_digit, N);
+                if (reached) {
+                    cutoff_digit = next_digit;
+                }
+                return reached;
             };
 
             // The pair does not match the criteria, so we divide it into N new pairs with larger denominators
             std::vector<fractions::convergent_pair<T>> child_pairs = {};
             fractions::subdivide(pair, N, cutoff_condition, child_pairs);
+
+            std::vector<work_item<T>> child_items = {};
+            child_items.reserve(child_pairs.size());
+            for (std::size_t i = 0; i < child_pairs.size(); i++) {
+                child_items.push_back({std::move(child_pairs[i]), item.root, {}});
+                if (certificate_output) {
+                    child_items.back().path = item.path;
+                    child_items.back().path.push_back(static_cast<int>(i) + 1);
+                }
+            }
+
+            if (certificate_output && cutoff_digit > 0) {
+                certificates::append(certificate_chunk, LW::acceptance_step::cutoff, item.root, item.path, result.best_q, cutoff_digit);
+            }
+
             // and add them to the work queue.
             work_queue_mutex.lock();
             // The new pairs are added at the end of the queue so the work is done in a depth-first-ish way,
             // which helps with keeping the memory requirements fairly constant.
-            queue.insert(std::end(queue), std::begin(child_pairs), std::end(child_pairs));
+            queue.insert(std::end(queue), std::make_move_iterator(std::begin(child_items)), std::make_move_iterator(std::end(child_items)));
             work_queue_mutex.unlock();
         } else {
             // No work available on the queue
@@ -174,25 +197,12 @@ void process(std::vector<fractions::convergent_pair<T>>& queue, int N) {
             std::this_thread::sleep_for(2000ms);
         }
     }
-}
-
-template <typename T>
-std::vector<fractions::convergent_pair<T>> select_bucket(std::vector<fractions::convergent_pair<T>>& pairs, configuration config) {
-    assert(pairs.size() >= config.buckets);
-
-    if (config.buckets == 1) {
-        return pairs;
-    }
-
-    std::vector<fractions::convergent_pair<T>> bucket = {};
 
-    int index = config.bucket - 1;
-    while (index < pairs.size()) {
-        bucket.push_back(pairs[index]);
-        index += config.buckets;
+    if (certificate_output) {
+        certificate_mutex.lock();
+        certificates::write_chunk(*certificate_output, certificate_chunk);
+        certificate_mutex.unlock();
     }
-
-    return bucket;
 }
 
 int main(int argc, char* argv[]) {
@@ -226,7 +236,7 @@ int main(int argc, char* argv[]) {
         pairs.size()
     ) << std::endl;
 
-    auto bucket = select_bucket<BigInt>(pairs, config);
+    auto bucket = fractions::select_bucket<BigInt>(pairs, config.buckets, config.bucket);
     std::cout << fmt::format(
         "Pairs split into {} buckets, processing bucket #{} which has {} pairs.",
         config.buckets,
@@ -241,14 +251,34 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    std::vector<work_item<BigInt>> queue = {};
+    queue.reserve(bucket.size());
+    for (std::size_t i = 0; i < bucket.size(); i++) {
+        queue.push_back({bucket[i], i, {}});
+    }
+
+    std::ofstream certificate_file;
+    std::ostream* certificate_output = nullptr;
+    if (!config.certificate_file.empty()) {
+        certificate_file.open(config.certificate_file, std::ios::binary);
+        assert(certificate_file.is_open());
+        certificates::write_header(certificate_file, {config.N, config.buckets, config.bucket, bucket.size()});
+        certificate_output = &certificate_file;
+        std::cout << fmt::format(
+            "Writing proof certificates to {}.",
+            config.certificate_file
+        ) << std::endl;
+    }
+
     thread_count = config.n_threads;
 
     std::vector<std::thread> threads;
     for (uint i = 0; i < config.n_threads; i++) {
             threads.emplace_back(
                 process<BigInt>,
-                std::ref(bucket),
-                config.N
+                std::ref(queue),
+                config.N,
+                certificate_output
             );
     }
 
@@ -256,6 +286,12 @@ int main(int argc, char* argv[]) {
         threads[i].join();
     }
 
+    if (certificate_output) {
+        certificates::write_end(certificate_file);
+        certificate_file.close();
+        assert(!certificate_file.fail());
+    }
+
     auto end = std::chrono::steady_clock::now();
 
     std::chrono::duration<double> elapsed_seconds = end - start;
@@ -0,0 +1,194 @@
+/**
+ * Copyright 2023 Topi Törmä, Matti Vapa
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <fstream>
+#include <functional>
+#include <sys/wait.h>
+#define FMT_HEADER_ONLY
+#include "dependencies/fmt/include/fmt/format.h"
+#include "big_int.hpp"
+#include "certificates.hpp"
+#include "fractions.hpp"
+#include "littlewood.hpp"
+
+/**
+ * Reads the certificates of a genuine run, writes modified copies of them and checks that the
+ * verifier accepts only the unmodified ones.
+ *
+ * Usage: lw-test-certificates <certificate file> <verifier>
+ */
+
+using records = std::vector<certificates::record<BigInt>>;
+
+// Writes the header, the raw bytes as their own chunk (if any) and the records as a single chunk.
+void write_certificates(const std::string& filename, const certificates::header& header, const records& certificates_to_write, const std::string& raw = "") {
+    std::ofstream output(filename, std::ios::binary);
+    certificates::write_header(output, header);
+    certificates::chunk chunk = {};
+    chunk.bytes = raw;
+    certificates::write_chunk(output, chunk);
+    for (std::size_t i = 0; i < certificates_to_write.size(); i++) {
+        const auto& record = certificates_to_write[i];
+        certificates::append(chunk, record.step, record.root, record.digits, record.q, record.cutoff_digit);
+    }
+    certificates::write_chunk(output, chunk);
+    certificates::write_end(output);
+}
+
+// Returns the index of the first record accepted by the given step.
+std::size_t find_step(const records& all, LW::acceptance_step step) {
+    for (std::size_t i = 0; i < all.size(); i++) {
+        if (all[i].step == step) {
+            return i;
+        }
+    }
+    std::cout << "The certificates have no records of a required step, use a larger N." << std::endl;
+    std::exit(1);
+}
+
+// Runs the verifier on the file and returns its exit code (or -1 if it did not exit normally) and its output.
+int run_verifier(const std::string& verifier, const std::string& filename, std::string& output) {
+    std::string output_file = filename + ".output";
+    int status = std::system(fmt::format("{} -c{} > {}", verifier, filename, output_file).c_str());
+    std::ifstream source(output_file);
+    output.assign(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+    std::remove(output_file.c_str());
+    return status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cout << "Usage: lw-test-certificates <certificate file> <verifier>" << std::endl;
+        return 1;
+    }
+    std::string filename = argv[1];
+    std::string verifier = argv[2];
+
+    std::ifstream input(filename, std::ios::binary);
+    certificates::header header = certificates::read_header(input);
+    records original = {};
+    std::string chunk;
+    while (certificates::read_chunk(input, chunk)) {
+        certificates::record<BigInt> record = {};
+        std::size_t position = 0;
+        while (position < chunk.size()) {
+            certificates::read_record(chunk, position, record);
+            original.push_back(record);
+        }
+    }
+
+    auto roots = fractions::select_bucket<BigInt>(fractions::convergent_pairs<BigInt>(header.N), header.buckets, header.bucket);
+
+    std::string modified = filename + ".modified";
+    int failures = 0;
+
+    // Checks that the verifier exits with the expected code and that its output contains the expected message.
+    auto expect = [&](const std::string& name, int expected_code, const std::string& expected_message) {
+        std::string output;
+        int code = run_verifier(verifier, modified, output);
+        bool passed = code == expected_code && output.find(expected_message) != std::string::npos;
+        std::cout << fmt::format("{}: {}", passed ? "PASS" : "FAIL", name) << std::endl;
+        if (!passed) {
+            failures++;
+        }
+    };
+
+    auto check = [&](const std::string& name, bool expected, std::function<void(records&, std::string&)> modify, const std::string& expected_message = "") {
+        records modified_records = original;
+        std::string raw = "";
+        modify(modified_records, raw);
+        write_certificates(modified, header, modified_records, raw);
+        expect(name, expected ? 0 : 1, expected_message);
+    };
+
+    check("Unmodified certificates are accepted", true, [](records&, std::string&) {});
+
+    check("Missing leaf is rejected", false, [](records& all, std::string&) {
+        all.erase(all.begin() + find_step(all, LW::acceptance_step::step_2b_i));
+    });
+
+    check("Duplicate leaf is rejected", false, [](records& all, std::string&) {
+        all.push_back(all[find_step(all, LW::acceptance_step::step_2b_i)]);
+    });
+
+    check("Record below a leaf is rejected", false, [](records& all, std::string&) {
+        auto record = all[find_step(all, LW::acceptance_step::step_2a)];
+        record.digits.push_back(1);
+        all.push_back(record);
+    });
+
+    check("Cutoff digit out of range is rejected", false, [&header](records& all, std::string&) {
+        all[find_step(all, LW::acceptance_step::cutoff)].cutoff_digit = header.N;
+    });
+
+    check("Cutoff with a larger digit is rejected", false, [](records& all, std::string&) {
+        all[find_step(all, LW::acceptance_step::cutoff)].cutoff_digit++;
+    });
+
+    check("Modified Q is rejected", false, [](records& all, std::string&) {
+        all[find_step(all, LW::acceptance_step::step_2a)].q += 1;
+    });
+
+    check("Q of a different step is rejected", false, [](records& all, std::string&) {
+        all[find_step(all, LW::acceptance_step::step_2b_i)].step = LW::acceptance_step::step_2b_v;
+    });
+
+    // The verifier must not follow a path below a pair whose children could overflow the integers,
+    // even when the certificate at the end of the path has the right form.
+    check("Path past the overflow protection is rejected", false, [&header, &roots](records& all, std::string&) {
+        fractions::convergent_pair<BigInt> pair = roots[0];
+        certificates::path digits = {};
+        bool fits = true;
+        while (fits) {
+            fits = subdivision_fits(pair.beta.current.den, header.N);
+            pair = fractions::child_pair(pair, header.N - 1);
+            digits.push_back(header.N - 1);
+        }
+        all.push_back({LW::acceptance_step::step_2a, 0, digits, pair.beta.current.den, 0});
+    }, "Initial pair #0 has an invalid certificate");
+
+    check("Q wider than the integers is rejected", false, [](records&, std::string& raw) {
+        raw.push_back(static_cast<char>(LW::acceptance_step::step_2a));
+        certificates::write_varint(raw, 0);
+        certificates::write_varint(raw, 0);
+        certificates::write_varint(raw, 0);
+        certificates::write_varint(raw, 1024);
+        raw.append(1024, '\x01');
+    });
+
+    check("Missing half of the records is rejected", false, [](records& all, std::string&) {
+        all.resize(all.size() / 2);
+    });
+
+    // Drop the end of the file, including the end marker.
+    {
+        write_certificates(modified, header, original);
+        std::ifstream source(modified, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+        std::ofstream(modified, std::ios::binary).write(bytes.data(), bytes.size() / 2);
+        expect("Truncated file is rejected", 1, "Verification failed: ");
+    }
+
+    // A chunk length far beyond the end of the file must not be allocated up front.
+    {
+        std::ofstream output(modified, std::ios::binary);
+        certificates::write_header(output, header);
+        std::string length;
+        certificates::write_varint(length, static_cast<std::uint64_t>(1) << 62);
+        output.write(length.data(), length.size());
+        output.close();
+        expect("Huge chunk length is rejected", 1, "Verification failed: ");
+    }
+
+    std::remove(modified.c_str());
+
+    std::cout << fmt::format("{} failure(s)", failures) << std::endl;
+    return failures > 0 ? 1 : 0;
+}
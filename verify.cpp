@@ -0,0 +1,477 @@
+/**
+ * Copyright 2023 Topi Törmä, Matti Vapa
+ */
+
+#include <iostream>
+#include <thread>
+#include <string>
+#include <cassert>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#define FMT_HEADER_ONLY
+#include "dependencies/fmt/include/fmt/format.h"
+#include "big_int.hpp"
+#include "certificates.hpp"
+#include "fractions.hpp"
+#include "littlewood.hpp"
+#include "visualisation.hpp"
+
+std::mutex input_mutex;
+std::mutex result_mutex;
+
+// The supported configuration options.
+struct configuration {
+    uint n_threads;
+    std::string certificate_file;
+};
+
+// Very naive CLI argument parser
+configuration parse_cli_arguments(int argc, char* argv[]) {
+    configuration config = {1, ""};
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            auto argument = std::string(argv[i]);
+            auto handle = argument.substr(0,2);
+            if (handle == "-j") {
+                config.n_threads = std::stoi(argument.substr(2));
+            } else if (handle == "-c") {
+                config.certificate_file = argument.substr(2);
+            }
+        }
+    }
+
+    assert(config.n_threads <= std::thread::hardware_concurrency());
+    assert(!config.certificate_file.empty());
+    return config;
+}
+
+// Number of verified certificates for each step of the algorithm.
+struct statistics {
+    std::uint64_t counts[8];
+};
+
+// The reasons for an initial pair failing the verification.
+const char invalid_certificate = 1;
+const char not_covered = 2;
+
+// State shared by the verifying threads. Everything except N and roots is guarded by result_mutex.
+template <typename T>
+struct verification {
+    int N;
+    std::vector<fractions::convergent_pair<T>> roots;
+    // The largest denominator of a pair that can be subdivided, when using fixed width integers.
+    T max_subdivision_den;
+    // The keys of the nodes covered by the certificates of each root, see append_node.
+    // Only these are kept in memory until the coverage of the search trees can be checked.
+    std::vector<std::string> nodes;
+    // The reason each root failed the verification, or 0.
+    std::vector<char> failed;
+    statistics counts;
+    std::uint64_t record_count;
+    std::string error;
+    // Guarded by input_mutex.
+    bool input_done;
+};
+
+/**
+ * Appends the key of a node of the search tree covered by a certificate: one byte for each digit of
+ * the path, a terminating zero byte and the cutoff digit (0 for accepted leaves). As the digits are
+ * at least 1, comparing the keys as C strings orders them like their paths.
+ */
+void append_node(std::string& output, const certificates::path& digits, int cutoff_digit) {
+    for (std::size_t i = 0; i < digits.size(); i++) {
+        output.push_back(static_cast<char>(digits[i]));
+    }
+    output.push_back('\0');
+    output.push_back(static_cast<char>(cutoff_digit));
+}
+
+#ifdef FIXED_WIDTH_INTEGERS
+/**
+ * Finds the largest denominator for which subdivision_fits holds. The condition is monotonic in the
+ * denominator, so a binary search can be used.
+ */
+BigInt largest_subdivision_den(int N) {
+    BigInt low = 1;
+    // (2^(w/6))^6 still fits into w bits, but is well above the limit of subdivision_fits.
+    BigInt high = static_cast<BigInt>(1) << (INTEGER_WIDTH / 6);
+    assert(subdivision_fits(low, N) && !subdivision_fits(high, N));
+    while (high - low > 1) {
+        BigInt middle = (low + high) / 2;
+        if (subdivision_fits(middle, N)) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+#endif
+
+/**
+ * Checks that the children of the pair can be checked without overflowing the integers. This is the
+ * same condition the overflow protection of the search uses before subdividing a pair.
+ */
+template <typename T>
+bool can_subdivide(const fractions::convergent_pair<T>& pair, const verification<T>& state) {
+    #ifdef FIXED_WIDTH_INTEGERS
+    return pair.beta.current.den <= state.max_subdivision_den;
+    #else
+    return true;
+    #endif
+}
+
+/**
+ * Checks a single certificate against the pair it was written for: Q must have the form of the claimed
+ * step, which also bounds it, and must pass a single evaluation of the "Littlewood quantity".
+ */
+template <typename T>
+bool certificate_holds(const fractions::convergent_pair<T>& pair, const certificates::record<T>& record, const verification<T>& state) {
+    int N = state.N;
+    if (!LW::has_step_form(pair, record.q, record.step, N)) {
+        return false;
+    }
+    if (record.step != LW::acceptance_step::cutoff) {
+        return LW::accepts(pair, record.q, N);
+    }
+    // The cutoff is only ever checked from the second digit onwards in subdivide, after the overflow protection.
+    return record.cutoff_digit >= 2
+        && record.cutoff_digit < N
+        && can_subdivide(pair, state)
+        && LW::littlewood_cutoff_reached(record.q, pair.alpha, pair.beta, record.cutoff_digit, N);
+}
+
+/**
+ * Checks the certificates of a chunk. The nodes of the valid certificates are appended to nodes
+ * prefixed with their root, and the roots of the invalid ones to failed.
+ */
+template <typename T>
+void check_chunk(const std::string& chunk, const verification<T>& state, statistics& counts, std::string& nodes, std::vector<std::size_t>& failed) {
+    certificates::record<T> record = {};
+    // pairs[k] is the pair at depth k along digits. Consecutive certificates of a chunk usually share a long
+    // prefix of their paths, so the pairs are only recalculated from the first differing digit onwards.
+    std::vector<fractions::convergent_pair<T>> pairs = {};
+    certificates::path digits = {};
+    std::uint64_t root = 0;
+
+    std::size_t position = 0;
+    while (position < chunk.size()) {
+        certificates::read_record(chunk, position, record);
+        if (record.root >= state.roots.size()) {
+            throw std::runtime_error("Certificate for an unknown initial pair.");
+        }
+
+        if (pairs.empty() || record.root != root) {
+            root = record.root;
+            pairs = {state.roots[root]};
+            digits.clear();
+        }
+
+        std::size_t depth = 0;
+        while (depth < digits.size() && depth < record.digits.size() && digits[depth] == record.digits[depth]) {
+            depth++;
+        }
+        pairs.resize(depth + 1);
+        digits.resize(depth);
+
+        bool valid = true;
+        while (valid && digits.size() < record.digits.size()) {
+            int digit = record.digits[digits.size()];
+            if (digit < 1 || digit >= state.N || !can_subdivide(pairs.back(), state)) {
+                valid = false;
+            } else {
+                pairs.push_back(fractions::child_pair(pairs.back(), digit));
+                digits.push_back(digit);
+            }
+        }
+
+        if (valid && certificate_holds(pairs.back(), record, state)) {
+            counts.counts[static_cast<int>(record.step)]++;
+            certificates::write_varint(nodes, root);
+            append_node(nodes, record.digits, record.cutoff_digit);
+        } else {
+            failed.push_back(root);
+        }
+    }
+}
+
+template <typename T>
+void set_error(verification<T>& state, const std::string& error) {
+    result_mutex.lock();
+    if (state.error.empty()) {
+        state.error = error;
+    }
+    result_mutex.unlock();
+}
+
+/**
+ * Reads chunks from the input until it is exhausted and checks their certificates. The input is
+ * shared between the threads, so each chunk is checked by whichever thread happened to read it.
+ */
+template <typename T>
+void check_chunks(std::istream& input, verification<T>& state) {
+    statistics counts = {};
+    std::uint64_t record_count = 0;
+    std::vector<std::size_t> failed = {};
+    std::string chunk;
+    std::string nodes;
+
+    while (true) {
+        input_mutex.lock();
+        bool has_chunk = false;
+        if (!state.input_done) {
+            try {
+                has_chunk = certificates::read_chunk(input, chunk);
+            } catch (const std::exception& error) {
+                set_error(state, error.what());
+            }
+            state.input_done = !has_chunk;
+        }
+        input_mutex.unlock();
+
+        if (!has_chunk) {
+            break;
+        }
+
+        try {
+            check_chunk(chunk, state, counts, nodes, failed);
+        } catch (const std::exception& error) {
+            set_error(state, error.what());
+            input_mutex.lock();
+            state.input_done = true;
+            input_mutex.unlock();
+            break;
+        }
+
+        // Hand the nodes of the chunk over to their roots.
+        result_mutex.lock();
+        std::size_t position = 0;
+        while (position < nodes.size()) {
+            std::uint64_t root = certificates::read_varint(nodes, position);
+            std::size_t start = position;
+            position = nodes.find('\0', start) + 2;
+            state.nodes[root].append(nodes, start, position - start);
+            record_count++;
+        }
+        result_mutex.unlock();
+        nodes.clear();
+    }
+
+    result_mutex.lock();
+    for (int i = 0; i < 8; i++) {
+        state.counts.counts[i] += counts.counts[i];
+    }
+    state.record_count += record_count + failed.size();
+    for (std::size_t i = 0; i < failed.size(); i++) {
+        state.failed[failed[i]] = invalid_certificate;
+    }
+    result_mutex.unlock();
+}
+
+/**
+ * Checks that the subtree of the search tree rooted at path is covered by the nodes whose keys start
+ * at the sorted offsets, starting from the offset at index. Every node that belongs to the subtree is consumed.
+ */
+bool covered(std::string& path, const std::string& keys, const std::vector<std::size_t>& offsets, std::size_t& index, int N) {
+    if (index == offsets.size()) {
+        return false;
+    }
+
+    const char* key = keys.data() + offsets[index];
+    std::size_t length = std::strlen(key);
+    if (length < path.size() || std::memcmp(path.data(), key, path.size()) != 0) {
+        return false;
+    }
+
+    // Children with digits below this one must be covered by the following nodes.
+    int last_digit = N;
+
+    if (length == path.size()) {
+        index++;
+        int cutoff_digit = static_cast<unsigned char>(key[length + 1]);
+        if (cutoff_digit == 0) {
+            return true;
+        }
+        last_digit = cutoff_digit;
+    }
+
+    for (int digit = 1; digit < last_digit; digit++) {
+        path.push_back(static_cast<char>(digit));
+        bool result = covered(path, keys, offsets, index, N);
+        path.pop_back();
+        if (!result) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+void check_coverage(verification<T>& state, std::atomic<std::size_t>& next_root) {
+    std::vector<std::size_t> failed = {};
+    std::vector<std::size_t> offsets = {};
+
+    // Each root is checked independently, so the threads just take the next unchecked root.
+    for (std::size_t root = next_root++; root < state.roots.size(); root = next_root++) {
+        if (state.failed[root]) {
+            continue;
+        }
+
+        const std::string& keys = state.nodes[root];
+        offsets.clear();
+        for (std::size_t position = 0; position < keys.size(); position += std::strlen(keys.data() + position) + 2) {
+            offsets.push_back(position);
+        }
+
+        std::sort(offsets.begin(), offsets.end(), [&keys](std::size_t a, std::size_t b) {
+            return std::strcmp(keys.data() + a, keys.data() + b) < 0;
+        });
+
+        std::string path = "";
+        std::size_t index = 0;
+        // All the nodes of the root must be consumed, anything left over is a duplicate or outside of the tree.
+        if (!covered(path, keys, offsets, index, state.N) || index != offsets.size()) {
+            failed.push_back(root);
+        }
+
+        // The nodes of the root are no longer needed.
+        std::string().swap(state.nodes[root]);
+    }
+
+    result_mutex.lock();
+    for (std::size_t i = 0; i < failed.size(); i++) {
+        state.failed[failed[i]] = not_covered;
+    }
+    result_mutex.unlock();
+}
+
+int main(int argc, char* argv[]) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto config = parse_cli_arguments(argc, argv);
+
+    std::ifstream certificate_file(config.certificate_file, std::ios::binary);
+    if (!certificate_file.is_open()) {
+        std::cout << fmt::format("Could not open {}.", config.certificate_file) << std::endl;
+        return 1;
+    }
+
+    verification<BigInt> state = {};
+
+    try {
+        auto header = certificates::read_header(certificate_file);
+
+        std::cout << fmt::format(
+            "Verifying certificates of N={}, bucket #{} of {}, on {} thread(s).",
+            header.N,
+            header.bucket,
+            header.buckets,
+            config.n_threads
+        ) << std::endl;
+
+        if (header.N < 2 || header.buckets < 1 || header.bucket < 1 || header.bucket > header.buckets) {
+            throw std::runtime_error("Invalid configuration in the certificate header.");
+        }
+        // The digits of the paths are kept in single bytes.
+        if (header.N > 255) {
+            throw std::runtime_error("The verifier supports N up to 255.");
+        }
+
+        auto pairs = fractions::convergent_pairs<BigInt>(header.N);
+        if (pairs.size() < header.buckets) {
+            throw std::runtime_error("Invalid configuration in the certificate header.");
+        }
+        state.N = header.N;
+        #ifdef FIXED_WIDTH_INTEGERS
+        state.max_subdivision_den = largest_subdivision_den(state.N);
+        #endif
+        state.roots = fractions::select_bucket<BigInt>(pairs, header.buckets, header.bucket);
+        if (state.roots.size() != header.root_count) {
+            throw std::runtime_error("The number of initial pairs does not match the certificate header.");
+        }
+    } catch (const std::exception& error) {
+        std::cout << fmt::format("Verification failed: {}", error.what()) << std::endl;
+        return 1;
+    }
+
+    state.nodes.resize(state.roots.size());
+    state.failed.resize(state.roots.size(), 0);
+
+    // The certificates are checked as they are read, only the paths are kept for checking the coverage.
+    std::vector<std::thread> threads;
+    for (uint i = 0; i < config.n_threads; i++) {
+            threads.emplace_back(
+                check_chunks<BigInt>,
+                std::ref(certificate_file),
+                std::ref(state)
+            );
+    }
+
+    for (std::size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    if (!state.error.empty()) {
+        std::cout << fmt::format("Verification failed: {}", state.error) << std::endl;
+        return 1;
+    }
+
+    std::cout << fmt::format(
+        "Read {} certificates for {} initial pairs.",
+        state.record_count,
+        state.roots.size()
+    ) << std::endl;
+
+    std::atomic<std::size_t> next_root = 0;
+
+    threads.clear();
+    for (uint i = 0; i < config.n_threads; i++) {
+            threads.emplace_back(
+                check_coverage<BigInt>,
+                std::ref(state),
+                std::ref(next_root)
+            );
+    }
+
+    for (std::size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    const char* step_names[8] = {"", "2(a)", "2(b) i", "2(b) ii", "2(b) iii", "2(b) iv", "2(b) v", "cutoff"};
+    for (int i = 1; i < 8; i++) {
+        std::cout << fmt::format("Step {}: {}", step_names[i], state.counts.counts[i]) << std::endl;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> elapsed_seconds = end - start;
+
+    bool failed = false;
+    for (std::size_t i = 0; i < state.roots.size(); i++) {
+        if (state.failed[i]) {
+            failed = true;
+            std::cout << fmt::format(
+                "Initial pair #{} {}: {}",
+                i,
+                state.failed[i] == invalid_certificate ? "has an invalid certificate" : "is not covered",
+                visualisation::string_representation(state.roots[i]).str()
+            ) << std::endl;
+        }
+    }
+
+    if (failed) {
+        std::cout << fmt::format("Verification failed in {:.2f} seconds", elapsed_seconds.count()) << std::endl;
+        return 1;
+    }
+
+    std::cout << fmt::format("Verification succeeded in {:.2f} seconds", elapsed_seconds.count()) << std::endl;
+
+    return 0;
+}